@@ -26,13 +26,11 @@ typedef unsigned long u32;
 typedef unsigned char u8;
 
 
-/* Объявления глобальных переменных */
-
-u32 lfsr[2 * LFSRLEN];  /* реализовано с помощью техники "скользящего окна" */
-u32* ptr;
-u32 r1, r2;  /* FSM регистры */
-u32 outfrom_fsm;
-u32 next_r1, next_r2;
+/*
+ * Контекст по умолчанию, с которым работают snow_loadkey и snow_keystream.
+ * Для нескольких одновременных сессий используйте собственные snow_ctx.
+ */
+static snow_ctx default_ctx;
 
 
 /*
@@ -45,13 +43,15 @@ u32 next_r1, next_r2;
  *
  * Возвращает: void
  */
-INLINE void  snow_update_internals() {
+INLINE void  snow_update_internals(snow_ctx* ctx) {
 	u32 tmp;
-	outfrom_fsm = (r1 + *(ptr + S1)) ^ r2;
-	tmp = outfrom_fsm + r2;
+	u32* ptr = ctx->lfsr + ctx->pos;
+	u32 r1 = ctx->r1;
+	ctx->outfrom_fsm = (r1 + *(ptr + S1)) ^ ctx->r2;
+	tmp = ctx->outfrom_fsm + ctx->r2;
 	tmp = ((tmp << 7) | (tmp >> 25));
-	next_r1 = tmp ^ r1;
-	next_r2 = SBox_0[r1 & 0xff] | SBox_1[(r1 >> 8) & 0xff] |
+	ctx->next_r1 = tmp ^ r1;
+	ctx->next_r2 = SBox_0[r1 & 0xff] | SBox_1[(r1 >> 8) & 0xff] |
 		SBox_2[(r1 >> 16) & 0xff] | SBox_3[(r1 >> 24) & 0xff];
 } 
 
@@ -63,18 +63,19 @@ INLINE void  snow_update_internals() {
  *
  * Возвращает: void
  */
-INLINE void snow_clock() {
+INLINE void snow_clock(snow_ctx* ctx) {
 	u32 feedback;
+	u32* ptr = ctx->lfsr + ctx->pos;
 	/* обновляем LFSR сначала */
 	feedback = *(ptr + S7) ^ *(ptr + S13) ^ *(ptr + S16);
 	if (feedback & highbit) feedback = (feedback << 1) ^ alphaxor;
 	else feedback = (feedback << 1);
 	*ptr = *(ptr + LFSRLEN) = feedback;
-	if (ptr == lfsr) ptr = lfsr + 15; else ptr--;
+	if (ctx->pos == 0) ctx->pos = 15; else ctx->pos--;
 
 	/* и обновляем FSM регистры */
-	r1 = next_r1;
-	r2 = next_r2;
+	ctx->r1 = ctx->next_r1;
+	ctx->r2 = ctx->next_r2;
 }
 
 /*
@@ -86,22 +87,23 @@ INLINE void snow_clock() {
  *
  * Возвращает: void
  */
-INLINE void snow_feedback_clock() {
+INLINE void snow_feedback_clock(snow_ctx* ctx) {
 	u32 feedback;
+	u32* ptr = ctx->lfsr + ctx->pos;
 	/* обновляем LFSR сначала */
-	feedback = *(ptr + S7) ^ *(ptr + S13) ^ *(ptr + S16) ^ outfrom_fsm;
+	feedback = *(ptr + S7) ^ *(ptr + S13) ^ *(ptr + S16) ^ ctx->outfrom_fsm;
 	if (feedback & highbit) feedback = (feedback << 1) ^ alphaxor;
 	else feedback = (feedback << 1);
 	*ptr = *(ptr + LFSRLEN) = feedback;
-	if (ptr == lfsr) ptr = lfsr + 15; else ptr--;
+	if (ctx->pos == 0) ctx->pos = 15; else ctx->pos--;
 
 	/* и обновляем FSM регистры */
-	r1 = next_r1;
-	r2 = next_r2;
+	ctx->r1 = ctx->next_r1;
+	ctx->r2 = ctx->next_r2;
 } 
 
 /*
- * Функция:  snow_loadkey
+ * Функция:  snow_ctx_loadkey
  *
  * Предназначение:
  *   Загружает материал ключа и выполняет первоначальное перемешивание.
@@ -119,9 +121,10 @@ INLINE void snow_feedback_clock() {
  *						...
  *					key[keysize/8-1] -> lsb of lfsr[keysize/32-1]
  */
-void snow_loadkey(u8* key, u32 keysize, int mode, u32 IV2, u32 IV1)
+void snow_ctx_loadkey(snow_ctx* ctx, u8* key, u32 keysize, int mode, u32 IV2, u32 IV1)
 {
 	int i;
+	u32* lfsr = ctx->lfsr;
 
 	if (keysize == 128) {
 		lfsr[0] = (((u32) * (key + 0)) << 24) ^ (((u32) * (key + 1)) << 16) ^
@@ -181,34 +184,111 @@ void snow_loadkey(u8* key, u32 keysize, int mode, u32 IV2, u32 IV1)
 	for (i = 0; i < LFSRLEN; i++)
 		lfsr[i + LFSRLEN] = lfsr[i];
 
-	r1 = 0;
-	r2 = 0;
+	ctx->r1 = 0;
+	ctx->r2 = 0;
 
-	ptr = lfsr + 15;  /* начнем с ptr регистра, который будет обновлен */
+	ctx->pos = 15;  /* начнем с регистра, который будет обновлен */
 
-	snow_update_internals();
+	snow_update_internals(ctx);
 	for (i = 0; i < mode; i++) {
-		snow_feedback_clock();
-		snow_update_internals();
+		snow_feedback_clock(ctx);
+		snow_update_internals(ctx);
 	}
 }
 
 /*
- * Функция: snow_keystream
+ * Функция: snow_ctx_keystream
  *
  * Предназначение:
- *   Создает рабочее ключевое слово и обновляет lfsr и fsm.
+ *   Создает рабочее ключевое слово и обновляет lfsr и fsm контекста.
  *
  * Возвращает: ключевое слово
  *
  */
-u32 snow_keystream() {
+u32 snow_ctx_keystream(snow_ctx* ctx) {
 	u32 runningkey;
 
-	runningkey = outfrom_fsm ^ *(ptr + S16);
-	snow_clock();
-	snow_update_internals();
+	runningkey = ctx->outfrom_fsm ^ *(ctx->lfsr + ctx->pos + S16);
+	snow_clock(ctx);
+	snow_update_internals(ctx);
 
 	return(runningkey);
+}
+
+/*
+ * Функция: snow_ctx_keystream_block
+ *
+ * Предназначение:
+ *   Заполняет out[0..n-1] последовательными ключевыми словами контекста.
+ *   Результат совпадает с n вызовами snow_ctx_keystream. Позиция окна
+ *   и регистры FSM держатся в локальных переменных на весь цикл и
+ *   записываются в контекст в конце: out имеет тот же тип, что и поля
+ *   контекста, и иначе компилятор перечитывал бы их после каждой записи.
+ *
+ * Возвращает: void
+ */
+void snow_ctx_keystream_block(snow_ctx* ctx, u32* out, u32 n) {
+	u32* lfsr = ctx->lfsr;
+	u32* ptr;
+	int pos = ctx->pos;
+	u32 r1 = ctx->r1, r2 = ctx->r2;
+	u32 outfrom_fsm = ctx->outfrom_fsm;
+	u32 next_r1 = ctx->next_r1, next_r2 = ctx->next_r2;
+	u32 feedback, tmp, i;
+
+	for (i = 0; i < n; i++) {
+		ptr = lfsr + pos;
+		out[i] = outfrom_fsm ^ *(ptr + S16);
+
+		/* snow_clock */
+		feedback = *(ptr + S7) ^ *(ptr + S13) ^ *(ptr + S16);
+		if (feedback & highbit) feedback = (feedback << 1) ^ alphaxor;
+		else feedback = (feedback << 1);
+		*ptr = *(ptr + LFSRLEN) = feedback;
+		if (pos == 0) pos = 15; else pos--;
+		r1 = next_r1;
+		r2 = next_r2;
+
+		/* snow_update_internals */
+		ptr = lfsr + pos;
+		outfrom_fsm = (r1 + *(ptr + S1)) ^ r2;
+		tmp = outfrom_fsm + r2;
+		tmp = ((tmp << 7) | (tmp >> 25));
+		next_r1 = tmp ^ r1;
+		next_r2 = SBox_0[r1 & 0xff] | SBox_1[(r1 >> 8) & 0xff] |
+			SBox_2[(r1 >> 16) & 0xff] | SBox_3[(r1 >> 24) & 0xff];
+	}
+
+	ctx->pos = pos;
+	ctx->r1 = r1;
+	ctx->r2 = r2;
+	ctx->outfrom_fsm = outfrom_fsm;
+	ctx->next_r1 = next_r1;
+	ctx->next_r2 = next_r2;
+}
 
+/*
+ * Функция:  snow_loadkey
+ *
+ * Предназначение:
+ *   То же, что snow_ctx_loadkey, но для контекста по умолчанию.
+ *
+ * Возвращает: void
+ */
+void snow_loadkey(u8* key, u32 keysize, int mode, u32 IV2, u32 IV1)
+{
+	snow_ctx_loadkey(&default_ctx, key, keysize, mode, IV2, IV1);
+}
+
+/*
+ * Функция: snow_keystream
+ *
+ * Предназначение:
+ *   Создает рабочее ключевое слово контекста по умолчанию.
+ *
+ * Возвращает: ключевое слово
+ *
+ */
+u32 snow_keystream() {
+	return(snow_ctx_keystream(&default_ctx));
 }
\ No newline at end of file
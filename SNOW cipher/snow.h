@@ -3,6 +3,20 @@
 #define STANDARD_MODE 64
 #define IV_MODE 32
 
+/*
+ *    .  , 
+ *       .
+ *    ,     
+ * (,    snow_ctx_loadkey).
+ */
+typedef struct snow_ctx {
+	unsigned long lfsr[32];  /* " "    LFSR */
+	int pos;                 /*  ,    */
+	unsigned long r1, r2;    /* FSM  */
+	unsigned long outfrom_fsm;
+	unsigned long next_r1, next_r2;
+} snow_ctx;
+
 /*
  * :  snow_loadkey
  *
@@ -37,3 +51,39 @@ extern void snow_loadkey(unsigned char* key,
  *
  */
 extern unsigned long snow_keystream();
+
+
+/*
+ * :  snow_ctx_loadkey
+ *
+ * :
+ *    ,  snow_loadkey,    .
+ *
+ * : void
+ */
+extern void snow_ctx_loadkey(snow_ctx* ctx, unsigned char* key,
+	unsigned long keysize, int mode,
+	unsigned long  IV2, unsigned long IV1);
+
+
+/*
+ * : snow_ctx_keystream
+ *
+ * :
+ *    ,  snow_keystream,    .
+ *
+ * :  
+ */
+extern unsigned long snow_ctx_keystream(snow_ctx* ctx);
+
+
+/*
+ * : snow_ctx_keystream_block
+ *
+ * :
+ *    n      out.
+ *
+ * : void
+ */
+extern void snow_ctx_keystream_block(snow_ctx* ctx,
+	unsigned long* out, unsigned long n);
@@ -0,0 +1,363 @@
+﻿#define _CRT_SECURE_NO_WARNINGS  /* fopen/fread без предупреждений SDL */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#endif
+#include "snow.h"
+#include "snowfile.h"
+
+#define DEFAULT_CHUNK (1UL << 20)
+#define TMP_SUFFIX    ".snowtmp"
+#define KS_WORDS      1024  /* ключевых слов за один snow_ctx_keystream_block */
+
+
+typedef unsigned long u32;
+typedef unsigned char u8;
+typedef std::chrono::steady_clock steady_t;
+
+
+/*
+ * Общее состояние одного вызова snow_encrypt_files. Потоки ввода/вывода
+ * берут задания из счетчика next; шифровать одновременно могут не
+ * больше slots из них.
+ */
+typedef struct snow_batch {
+	const snow_file_job* jobs;
+	u32 njobs;
+	u8* key;
+	u32 keysize;
+	u32 chunk;
+	std::atomic<u32> next;
+	std::mutex lock;
+	std::condition_variable freed;
+	unsigned int slots;
+} snow_batch;
+
+
+/*
+ * Функция: seconds_since
+ *
+ * Возвращает: время в секундах, прошедшее с момента start
+ */
+static double seconds_since(steady_t::time_point start) {
+	return std::chrono::duration<double>(steady_t::now() - start).count();
+}
+
+/*
+ * Функции: acquire_slot, release_slot
+ *
+ * Предназначение:
+ *   Занимают и освобождают место для шифрования, ограничивая число
+ *   ядер, занятых шифром, независимо от числа файлов в обработке.
+ *
+ * Возвращает: void
+ */
+static void acquire_slot(snow_batch* b) {
+	std::unique_lock<std::mutex> guard(b->lock);
+	b->freed.wait(guard, [b]() { return b->slots > 0; });
+	b->slots--;
+}
+
+static void release_slot(snow_batch* b) {
+	{
+		std::lock_guard<std::mutex> guard(b->lock);
+		b->slots++;
+	}
+	b->freed.notify_one();
+}
+
+/*
+ * Функция: replace_file
+ *
+ * Предназначение:
+ *   Одним действием заменяет to файлом from. Если замена не удалась,
+ *   to остается нетронутым.
+ *
+ * Возвращает: 0 при успехе, -1 при ошибке
+ */
+static int replace_file(const char* from, const char* to) {
+#ifdef _WIN32
+	/* rename на Windows не заменяет существующий файл */
+	if (!MoveFileExA(from, to, MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH))
+		return -1;
+#else
+	if (rename(from, to) != 0)
+		return -1;
+#endif
+	return 0;
+}
+
+/*
+ * Функция: snow_xor_chunk
+ *
+ * Предназначение:
+ *   Накладывает len байт ключевого потока на buf. Ключевые слова
+ *   создаются порциями по KS_WORDS в буфере на стеке; хвост последнего
+ *   слова отбрасывается.
+ *
+ * Возвращает: void
+ */
+static void snow_xor_chunk(snow_ctx* ctx, u8* buf, u32 len) {
+	u32 ks[KS_WORDS];
+	u32 i, words;
+	u8 word[4];
+
+	while (len >= 4) {
+		words = len / 4;
+		if (words > KS_WORDS) words = KS_WORDS;
+		snow_ctx_keystream_block(ctx, ks, words);
+		for (i = 0; i < words; i++, buf += 4) {
+			buf[0] ^= (u8)(ks[i] >> 24);
+			buf[1] ^= (u8)(ks[i] >> 16);
+			buf[2] ^= (u8)(ks[i] >> 8);
+			buf[3] ^= (u8)(ks[i]);
+		}
+		len -= 4 * words;
+	}
+	if (len > 0) {
+		ks[0] = snow_ctx_keystream(ctx);
+		word[0] = (u8)(ks[0] >> 24);
+		word[1] = (u8)(ks[0] >> 16);
+		word[2] = (u8)(ks[0] >> 8);
+		word[3] = (u8)(ks[0]);
+		for (i = 0; i < len; i++)
+			buf[i] ^= word[i];
+	}
+}
+
+/*
+ * Функция: snow_encrypt_one
+ *
+ * Предназначение:
+ *   Обрабатывает одно задание, используя буферы потока, и добавляет
+ *   время этапов в stats. Результат пишется во временный файл, который
+ *   переименовывается в out_path только после успешной записи.
+ *
+ * Возвращает: 0 при успехе, -1 при ошибке
+ */
+static int snow_encrypt_one(snow_batch* b, const snow_file_job* job,
+	u8* buf, snow_batch_stats* stats) {
+	snow_ctx ctx;
+	FILE *in, *out;
+	char* tmp_path;
+	size_t n;
+	int err = 0;
+	steady_t::time_point t;
+
+	tmp_path = (char*)malloc(strlen(job->out_path) + sizeof(TMP_SUFFIX));
+	if (tmp_path == NULL) return -1;
+	strcpy(tmp_path, job->out_path);
+	strcat(tmp_path, TMP_SUFFIX);
+
+	t = steady_t::now();
+	in = fopen(job->in_path, "rb");
+	stats->read_seconds += seconds_since(t);
+	if (in == NULL) {
+		free(tmp_path);
+		return -1;
+	}
+	t = steady_t::now();
+	out = fopen(tmp_path, "wb");
+	stats->write_seconds += seconds_since(t);
+	if (out == NULL) {
+		fclose(in);
+		free(tmp_path);
+		return -1;
+	}
+
+	/*
+	 * acquire_slot и release_slot могут бросить std::system_error
+	 * из мьютекса; тогда задание считается неудачным, а файлы
+	 * закрываются и удаляются ниже.
+	 */
+	try {
+		t = steady_t::now();
+		acquire_slot(b);
+		snow_ctx_loadkey(&ctx, b->key, b->keysize, IV_MODE, job->IV2, job->IV1);
+		release_slot(b);
+		stats->encrypt_seconds += seconds_since(t);
+
+		for (;;) {
+			t = steady_t::now();
+			n = fread(buf, 1, b->chunk, in);
+			stats->read_seconds += seconds_since(t);
+			if (n == 0) break;
+
+			t = steady_t::now();
+			acquire_slot(b);
+			snow_xor_chunk(&ctx, buf, (u32)n);
+			release_slot(b);
+			stats->encrypt_seconds += seconds_since(t);
+
+			t = steady_t::now();
+			if (fwrite(buf, 1, n, out) != n) err = -1;
+			stats->write_seconds += seconds_since(t);
+			if (err) break;
+
+			stats->bytes += n;
+			if (n < b->chunk) break;
+		}
+	}
+	catch (...) {
+		err = -1;
+	}
+	if (ferror(in)) err = -1;
+	fclose(in);  /* до переименования: in_path может совпадать с out_path */
+
+	t = steady_t::now();
+	if (fclose(out) != 0) err = -1;
+	if (err == 0 && replace_file(tmp_path, job->out_path) != 0) err = -1;
+	if (err) remove(tmp_path);  /* out_path при этом не тронут */
+	stats->write_seconds += seconds_since(t);
+
+	free(tmp_path);
+	return err;
+}
+
+/*
+ * Функция: snow_batch_worker
+ *
+ * Предназначение:
+ *   Тело потока ввода/вывода: берет задания, пока они не кончатся.
+ *
+ * Возвращает: void
+ */
+static void snow_batch_worker(snow_batch* b, u8* buf, snow_batch_stats* st) {
+	u32 i;
+	int err;
+
+	while ((i = b->next.fetch_add(1)) < b->njobs) {
+		err = snow_encrypt_one(b, &b->jobs[i], buf, st);
+		if (err == 0) st->files_done++;
+		else st->files_failed++;
+	}
+}
+
+/*
+ * Функция:  snow_encrypt_files
+ *
+ * Предназначение:
+ *   Запускает io_depth потоков ввода/вывода, каждый со своим буфером.
+ *   Пока одни потоки ждут диск, другие шифруют, но не больше workers
+ *   одновременно. Буферы выделяются до запуска потоков; если памяти
+ *   или потоков не хватает, работа идет на меньшем их числе.
+ *
+ * Возвращает: число файлов, которые не удалось обработать
+ */
+unsigned long snow_encrypt_files(const snow_file_job* jobs, u32 njobs,
+	u8* key, u32 keysize, const snow_batch_opts* opts, snow_batch_stats* stats) {
+	unsigned int io_depth = opts ? opts->io_depth : 0;
+	unsigned int workers = opts ? opts->workers : 0;
+	u32 chunk = opts ? opts->chunk_bytes : 0;
+	u8* bufs[SNOW_MAX_IO_DEPTH];
+	snow_batch_stats part[SNOW_MAX_IO_DEPTH];
+	std::thread pool[SNOW_MAX_IO_DEPTH];
+	snow_batch_stats total;
+	snow_batch b;
+	steady_t::time_point start = steady_t::now();
+	unsigned int w, started = 0;
+
+	memset(&total, 0, sizeof(total));
+	if (njobs == 0) {
+		if (stats) *stats = total;
+		return 0;
+	}
+
+	if (workers == 0) workers = std::thread::hardware_concurrency();
+	if (workers == 0) workers = 1;
+	if (workers > SNOW_MAX_WORKERS) workers = SNOW_MAX_WORKERS;
+	if (io_depth == 0) io_depth = 4 * workers;
+	if (io_depth > SNOW_MAX_IO_DEPTH) io_depth = SNOW_MAX_IO_DEPTH;
+	if (io_depth > njobs) io_depth = (unsigned int)njobs;
+	if (workers > io_depth) workers = io_depth;
+	if (chunk == 0) chunk = DEFAULT_CHUNK;
+	if (chunk > SNOW_MAX_CHUNK) chunk = SNOW_MAX_CHUNK;
+	chunk = (chunk + 3) & ~3UL;  /* целое число ключевых слов в блоке */
+
+	b.jobs = jobs;
+	b.njobs = njobs;
+	b.key = key;
+	b.keysize = keysize;
+	b.chunk = chunk;
+	b.next = 0;
+	b.slots = workers;
+
+	/*
+	 * Буферы не инициализируются: память не трогается до первого чтения,
+	 * а нехватка ее видна здесь как NULL. Продолжаем с теми буферами,
+	 * что удалось выделить.
+	 */
+	memset(part, 0, sizeof(part));
+	for (w = 0; w < io_depth; w++) {
+		bufs[w] = (u8*)malloc(chunk);
+		if (bufs[w] == NULL) break;
+	}
+	io_depth = w;
+
+	if (io_depth == 0) {
+		total.files_failed = njobs;
+	}
+	else {
+		for (w = 1; w < io_depth; w++) {
+			try {
+				pool[w - 1] = std::thread(snow_batch_worker, &b, bufs[w], &part[w]);
+			}
+			catch (...) {
+				break;
+			}
+			started++;
+		}
+		/* вызывающий поток работает как первый поток ввода/вывода */
+		snow_batch_worker(&b, bufs[0], &part[0]);
+		for (w = 0; w < started; w++)
+			pool[w].join();
+
+		for (w = 0; w <= started; w++) {
+			total.files_done += part[w].files_done;
+			total.files_failed += part[w].files_failed;
+			total.bytes += part[w].bytes;
+			total.read_seconds += part[w].read_seconds;
+			total.encrypt_seconds += part[w].encrypt_seconds;
+			total.write_seconds += part[w].write_seconds;
+		}
+	}
+	for (w = 0; w < io_depth; w++)
+		free(bufs[w]);
+	total.wall_seconds = seconds_since(start);
+
+	if (stats) *stats = total;
+	return(total.files_failed);
+}
+
+/*
+ * Функция:  snow_print_batch_stats
+ *
+ * Предназначение:
+ *   Выводит статистику пакетного шифрования по этапам.
+ *
+ * Возвращает: void
+ */
+void snow_print_batch_stats(FILE* out, const snow_batch_stats* stats) {
+	double mb = stats->bytes / (1024.0 * 1024.0);
+
+	fprintf(out, "%25s=%lu (%lu failed)\n", "files",
+		stats->files_done, stats->files_failed);
+	fprintf(out, "%25s=%.1f MiB\n", "bytes", mb);
+	fprintf(out, "%25s=%.3f s\n", "read", stats->read_seconds);
+	fprintf(out, "%25s=%.3f s\n", "encrypt", stats->encrypt_seconds);
+	fprintf(out, "%25s=%.3f s\n", "write", stats->write_seconds);
+	fprintf(out, "%25s=%.3f s", "wall", stats->wall_seconds);
+	if (stats->wall_seconds > 0)
+		fprintf(out, " (%.1f MiB/s)", mb / stats->wall_seconds);
+	fputc('\n', out);
+}
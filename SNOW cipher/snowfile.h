@@ -0,0 +1,94 @@
+﻿#pragma once
+
+#include <stdio.h>
+
+/*
+ * Верхние границы настроек; большие значения уменьшаются до них.
+ * Вместе они ограничивают память под буферы 1 ГиБ.
+ */
+#define SNOW_MAX_CHUNK    (16UL << 20)
+#define SNOW_MAX_IO_DEPTH 64
+#define SNOW_MAX_WORKERS  64
+
+/*
+ * Одно задание пакетного шифрования: входной и выходной файлы и
+ * значения IV, с которыми для файла создается отдельный контекст
+ * в режиме IV_MODE.
+ *
+ * Результат сначала пишется в "<out_path>.snowtmp" и переименовывается
+ * в out_path только при успехе, поэтому in_path и out_path могут
+ * совпадать. Разные задания не должны иметь общий out_path.
+ */
+typedef struct snow_file_job {
+	const char* in_path;
+	const char* out_path;
+	unsigned long IV2, IV1;
+} snow_file_job;
+
+/*
+ * Настройки пакетного шифрования.
+ *   io_depth    - сколько файлов обрабатывается одновременно, то есть
+ *                 сколько запросов чтения/записи может ждать диск;
+ *                 0 означает 4 * workers
+ *   workers     - сколько блоков может шифроваться одновременно,
+ *                 0 означает число ядер; не больше io_depth
+ *   chunk_bytes - размер одного запроса чтения/записи, 0 означает 1 МиБ
+ * Каждый поток ввода/вывода выделяет один буфер размером chunk_bytes,
+ * всего io_depth * chunk_bytes байт.
+ */
+typedef struct snow_batch_opts {
+	unsigned int io_depth;
+	unsigned int workers;
+	unsigned long chunk_bytes;
+} snow_batch_opts;
+
+/*
+ * Статистика пакетного шифрования. Время этапов суммируется по всем
+ * потокам, поэтому его можно сравнивать между собой, чтобы понять,
+ * что ограничивает скорость: диск или шифр.
+ *   read_seconds    - открытие и чтение входных файлов
+ *   encrypt_seconds - snow_ctx_loadkey, ожидание свободного места
+ *                     для шифрования и само шифрование
+ *   write_seconds   - создание, запись, закрытие и переименование
+ *                     выходных файлов
+ */
+typedef struct snow_batch_stats {
+	unsigned long files_done;
+	unsigned long files_failed;
+	unsigned long long bytes;
+	double read_seconds;
+	double encrypt_seconds;
+	double write_seconds;
+	double wall_seconds;
+} snow_batch_stats;
+
+
+/*
+ * Функция:  snow_encrypt_files
+ *
+ * Предназначение:
+ *   Шифрует (или расшифровывает) набор файлов. Каждый файл получает
+ *   свой контекст, инициализированный snow_ctx_loadkey с общим ключом
+ *   и IV из задания. Ключевые слова накладываются на данные в порядке
+ *   big-endian.
+ *
+ * Возвращает: число файлов, которые не удалось обработать
+ *
+ * Допустимые значения:
+ *   key и keysize как в snow_loadkey
+ *   opts и stats могут быть NULL
+ */
+extern unsigned long snow_encrypt_files(const snow_file_job* jobs,
+	unsigned long njobs, unsigned char* key, unsigned long keysize,
+	const snow_batch_opts* opts, snow_batch_stats* stats);
+
+
+/*
+ * Функция:  snow_print_batch_stats
+ *
+ * Предназначение:
+ *   Выводит статистику пакетного шифрования по этапам.
+ *
+ * Возвращает: void
+ */
+extern void snow_print_batch_stats(FILE* out, const snow_batch_stats* stats);
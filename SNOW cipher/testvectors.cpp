@@ -1,7 +1,18 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#ifdef _WIN32
+#include <direct.h>
+#define make_dir(path) _mkdir(path)
+#define remove_dir(path) _rmdir(path)
+#else
+#include <sys/stat.h>
+#include <unistd.h>
+#define make_dir(path) mkdir(path, 0755)
+#define remove_dir(path) rmdir(path)
+#endif
 #include "snow.h"
+#include "snowfile.h"
 
 
 #define U32TO8_BIG(c,v) do {\
@@ -160,7 +171,207 @@ void testvectors() {
 }
 
 
+/*
+ *  API .     
+ *   .
+ */
+int check(const char* str, int ok) {
+	printf("%25s=%s\n", str, ok ? "OK" : "FAILED");
+	return ok ? 0 : 1;
+}
+
+int ctx_tests() {
+	u32 i, ok;
+	u8 key[32];
+	u32 block[100], a[100], b[100];
+	snow_ctx c1, c2, c3;
+	int failed = 0;
+
+	printf("Context API checks\n");
+	printf("==================\n\n");
+
+	/*     ,      */
+	memset(key, 0xaa, 32);
+	snow_ctx_loadkey(&c1, key, 256, IV_MODE, 0x10203040, 0xabcdef01);
+	c2 = c1;
+	snow_ctx_keystream_block(&c1, block, 37);
+	snow_ctx_keystream_block(&c1, block + 37, 63);
+	ok = 1;
+	for (i = 0; i < 100; i++)
+		if (block[i] != snow_ctx_keystream(&c2)) ok = 0;
+	failed += check("block == keystream", ok);
+
+	/*       ,     */
+	memset(key, 0, 16);
+	key[0] = 0x80;
+	snow_ctx_loadkey(&c1, key, 128, STANDARD_MODE, 0, 0);
+	for (i = 0; i < 100; i++) a[i] = snow_ctx_keystream(&c1);
+	snow_ctx_loadkey(&c1, key, 128, IV_MODE, 0x01234567, 0xaaaaaaaa);
+	for (i = 0; i < 100; i++) b[i] = snow_ctx_keystream(&c1);
+
+	snow_ctx_loadkey(&c1, key, 128, STANDARD_MODE, 0, 0);
+	snow_ctx_loadkey(&c2, key, 128, IV_MODE, 0x01234567, 0xaaaaaaaa);
+	ok = 1;
+	for (i = 0; i < 100; i++) {
+		if (a[i] != snow_ctx_keystream(&c1)) ok = 0;
+		if (b[i] != snow_ctx_keystream(&c2)) ok = 0;
+	}
+	failed += check("interleaved contexts", ok);
+
+	/*       */
+	snow_ctx_loadkey(&c1, key, 128, STANDARD_MODE, 0, 0);
+	for (i = 0; i < 50; i++) snow_ctx_keystream(&c1);
+	c3 = c1;
+	ok = 1;
+	for (i = 50; i < 100; i++)
+		if (a[i] != snow_ctx_keystream(&c3)) ok = 0;
+	failed += check("copied context", ok);
+
+	/*       */
+	snow_loadkey(key, 128, STANDARD_MODE, 0, 0);
+	ok = 1;
+	for (i = 0; i < 100; i++)
+		if (a[i] != snow_keystream()) ok = 0;
+	failed += check("default context", ok);
+
+	printf("=========== End of context checks =========\n\n");
+	return failed;
+}
+
+/*
+ *      .
+ * read_file   malloc   NULL.
+ */
+int write_file(const char* path, const u8* data, u32 len) {
+	FILE* f = fopen(path, "wb");
+	int ok;
+
+	if (f == NULL) return 0;
+	ok = fwrite(data, 1, len, f) == len;
+	return (fclose(f) == 0) && ok;
+}
+
+u8* read_file(const char* path, u32* len) {
+	FILE* f = fopen(path, "rb");
+	u8* data;
+	long size;
+
+	if (f == NULL) return NULL;
+	fseek(f, 0, SEEK_END);
+	size = ftell(f);
+	fseek(f, 0, SEEK_SET);
+	data = (u8*)malloc(size + 1);
+	if (data != NULL && fread(data, 1, size, f) != (size_t)size) {
+		free(data);
+		data = NULL;
+	}
+	fclose(f);
+	*len = (u32)size;
+	return data;
+}
+
+#define BATCH_FILES 5
+#define BATCH_CHUNK 4096
+
+int batch_tests() {
+	/* , 1 ,   4,  ;    */
+	const u32 sizes[BATCH_FILES - 1] = { 0, 1, 7, 3 * BATCH_CHUNK + 5 };
+	const char* plain[BATCH_FILES] = { "snowtest_p0.bin", "snowtest_p1.bin",
+		"snowtest_p2.bin", "snowtest_p3.bin", "snowtest_missing.bin" };
+	const char* cipher[BATCH_FILES] = { "snowtest_c0.bin", "snowtest_c1.bin",
+		"snowtest_c2.bin", "snowtest_c3.bin", "snowtest_c4.bin" };
+	snow_file_job enc[BATCH_FILES], dec[BATCH_FILES - 1];
+	snow_batch_opts opts;
+	snow_batch_stats stats;
+	u8 key[16], keystream[4], * data, * out;
+	u32 i, j, len, failures, ok_enc = 1, ok_dec = 1;
+	int failed = 0;
+
+	printf("Batch encryption checks\n");
+	printf("==================\n\n");
+
+	memset(key, 0x5a, 16);
+	remove(plain[BATCH_FILES - 1]);
+	for (i = 0; i < BATCH_FILES; i++) {
+		enc[i].in_path = plain[i];
+		enc[i].out_path = cipher[i];
+		enc[i].IV2 = 0x01234567;
+		enc[i].IV1 = i;
+	}
+	for (i = 0; i < BATCH_FILES - 1; i++) {
+		data = (u8*)malloc(sizes[i] + 1);
+		for (j = 0; j < sizes[i]; j++) data[j] = (u8)(j * 7 + i);
+		write_file(plain[i], data, sizes[i]);
+		free(data);
+
+		/*   : in_path   out_path */
+		dec[i] = enc[i];
+		dec[i].in_path = dec[i].out_path = cipher[i];
+	}
+
+	opts.io_depth = 3;
+	opts.workers = 2;
+	opts.chunk_bytes = BATCH_CHUNK;
+	failures = snow_encrypt_files(enc, BATCH_FILES, key, 128, &opts, &stats);
+	snow_print_batch_stats(stdout, &stats);
+	failed += check("missing input failed", failures == 1 &&
+		stats.files_failed == 1 && stats.files_done == BATCH_FILES - 1);
+
+	/*    ,   snow_keystream */
+	for (i = 0; i < BATCH_FILES - 1; i++) {
+		data = read_file(plain[i], &len);
+		out = read_file(cipher[i], &len);
+		if (data == NULL || out == NULL || len != sizes[i]) ok_enc = 0;
+		else {
+			snow_loadkey(key, 128, IV_MODE, enc[i].IV2, enc[i].IV1);
+			for (j = 0; j < len; j++) {
+				if (j % 4 == 0) U32TO8_BIG(keystream, snow_keystream());
+				if ((u8)(data[j] ^ keystream[j % 4]) != out[j]) ok_enc = 0;
+			}
+		}
+		free(data);
+		free(out);
+	}
+	failed += check("matches snow_keystream", ok_enc);
+
+	failures = snow_encrypt_files(dec, BATCH_FILES - 1, key, 128, NULL, &stats);
+	for (i = 0; i < BATCH_FILES - 1; i++) {
+		data = read_file(plain[i], &len);
+		out = read_file(cipher[i], &j);
+		if (data == NULL || out == NULL || len != j ||
+			memcmp(data, out, len) != 0) ok_dec = 0;
+		free(data);
+		free(out);
+	}
+	failed += check("round trip", failures == 0 && ok_dec);
+
+	/*      ,    */
+	make_dir("snowtest_dir");
+	dec[0].in_path = plain[3];
+	dec[0].out_path = "snowtest_dir";
+	failures = snow_encrypt_files(dec, 1, key, 128, NULL, &stats);
+	data = read_file(plain[3], &len);
+	out = read_file("snowtest_dir.snowtmp", &j);
+	failed += check("failed replace keeps data", failures == 1 &&
+		data != NULL && len == sizes[3] && data[5] == (u8)(5 * 7 + 3) &&
+		out == NULL && remove_dir("snowtest_dir") == 0);
+	free(data);
+	free(out);
+
+	for (i = 0; i < BATCH_FILES; i++) {
+		remove(plain[i]);
+		remove(cipher[i]);
+	}
+	printf("=========== End of batch checks =========\n\n");
+	return failed;
+}
+
+
 int main() {
+	int failed;
+
 	testvectors();
-	return 0;
+	failed = ctx_tests();
+	failed += batch_tests();
+	return failed ? 1 : 0;
 }